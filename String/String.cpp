@@ -1,41 +1,613 @@
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Opt-in counters, compiled in only with STRING_INSTRUMENTATION defined.
+// They are per thread and count heap blocks taken by Strings, growths of an
+// existing buffer, and chars copied between buffers.
+#if defined(STRING_INSTRUMENTATION)
+struct StringStats {
+  size_t allocations = 0;
+  size_t reallocations = 0;
+  size_t bytes_copied = 0;
+};
+
+StringStats& string_stats() {
+  thread_local StringStats stats;
+  return stats;
+}
+
+#define STRING_COUNT(counter, amount) (string_stats().counter += (amount))
+#else
+#define STRING_COUNT(counter, amount) ((void)0)
+#endif
+
+const size_t NOT_FOUND = static_cast<size_t>(-1);
+const size_t SHORT_NEEDLE = 32;
+
+bool matches_inside(const char* candidate, const char* needle, size_t m) {
+  return m <= 2 || memcmp(candidate + 1, needle + 1, m - 2) == 0;
+}
+
+// First-and-last-byte filter: 16 candidate positions are tested per step and
+// only the ones where both ends match are compared in full.
+size_t find_short_forward(const char* hay, size_t n, const char* needle, size_t m) {
+  size_t end = n - m + 1;
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[m - 1]);
+  for (; i + 16 <= end; i += 16) {
+    __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+    __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                                    _mm_cmpeq_epi8(block_last, last)));
+    while (mask != 0) {
+      size_t candidate = i + __builtin_ctz(mask);
+      if (matches_inside(hay + candidate, needle, m)) {
+        return candidate;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  while (i < end) {
+    const void* hit = memchr(hay + i, needle[0], end - i);
+    if (hit == nullptr) {
+      return NOT_FOUND;
+    }
+    i = static_cast<const char*>(hit) - hay;
+    if (hay[i + m - 1] == needle[m - 1] && matches_inside(hay + i, needle, m)) {
+      return i;
+    }
+    ++i;
+  }
+  return NOT_FOUND;
+}
+
+size_t find_short_backward(const char* hay, size_t n, const char* needle, size_t m) {
+  size_t end = n - m + 1;
+#if defined(__SSE2__)
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[m - 1]);
+  while (end >= 16) {
+    size_t i = end - 16;
+    __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+    __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                                    _mm_cmpeq_epi8(block_last, last)));
+    while (mask != 0) {
+      int bit = 31 - __builtin_clz(mask);
+      if (matches_inside(hay + i + bit, needle, m)) {
+        return i + bit;
+      }
+      mask &= ~(1u << bit);
+    }
+    end = i;
+  }
+#endif
+  while (end > 0) {
+    --end;
+    if (hay[end] == needle[0] && hay[end + m - 1] == needle[m - 1] && matches_inside(hay + end, needle, m)) {
+      return end;
+    }
+  }
+  return NOT_FOUND;
+}
+
+// Crochemore-Perrin two-way search, linear in n + m for any input. With
+// Reverse set both strings are read back to front, so the first match found
+// is the last one in the original haystack.
+template <bool Reverse>
+size_t two_way_search(const char* hay, size_t n, const char* needle, size_t m) {
+  auto h = [&](size_t i) {
+    return static_cast<unsigned char>(Reverse ? hay[n - 1 - i] : hay[i]);
+  };
+  auto nd = [&](size_t i) {
+    return static_cast<unsigned char>(Reverse ? needle[m - 1 - i] : needle[i]);
+  };
+
+  size_t shift[256] = {0};
+  for (size_t i = 0; i < m; ++i) {
+    shift[nd(i)] = i + 1;
+  }
+
+  size_t ip = NOT_FOUND;
+  size_t jp = 0;
+  size_t k = 1;
+  size_t p = 1;
+  while (jp + k < m) {
+    if (nd(ip + k) == nd(jp + k)) {
+      if (k == p) {
+        jp += p;
+        k = 1;
+      } else {
+        ++k;
+      }
+    } else if (nd(ip + k) > nd(jp + k)) {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    } else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  size_t ms = ip;
+  size_t p0 = p;
+
+  ip = NOT_FOUND;
+  jp = 0;
+  k = p = 1;
+  while (jp + k < m) {
+    if (nd(ip + k) == nd(jp + k)) {
+      if (k == p) {
+        jp += p;
+        k = 1;
+      } else {
+        ++k;
+      }
+    } else if (nd(ip + k) < nd(jp + k)) {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    } else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  if (ip + 1 > ms + 1) {
+    ms = ip;
+  } else {
+    p = p0;
+  }
+
+  bool periodic = true;
+  for (size_t i = 0; i < ms + 1; ++i) {
+    if (nd(i) != nd(i + p)) {
+      periodic = false;
+      break;
+    }
+  }
+  size_t mem0 = 0;
+  if (periodic) {
+    mem0 = m - p;
+  } else {
+    p = std::max(ms, m - ms - 1) + 1;
+  }
+  size_t mem = 0;
+
+  size_t pos = 0;
+  while (pos + m <= n) {
+    size_t skip = shift[h(pos + m - 1)];
+    if (skip == 0) {
+      pos += m;
+      mem = 0;
+      continue;
+    }
+    if (m - skip != 0) {
+      pos += std::max(m - skip, mem);
+      mem = 0;
+      continue;
+    }
+    for (k = std::max(ms + 1, mem); k < m && nd(k) == h(pos + k); ++k) {}
+    if (k < m) {
+      pos += k - ms;
+      mem = 0;
+      continue;
+    }
+    for (k = ms + 1; k > mem && nd(k - 1) == h(pos + k - 1); --k) {}
+    if (k <= mem) {
+      return Reverse ? n - pos - m : pos;
+    }
+    pos += p;
+    mem = mem0;
+  }
+  return NOT_FOUND;
+}
+
+// First match starting at or after pos.
+size_t search_forward(const char* hay, size_t n, const char* needle, size_t m, size_t pos = 0) {
+  if (pos > n || m > n - pos) {
+    return NOT_FOUND;
+  }
+  if (m == 0) {
+    return pos;
+  }
+  size_t found;
+  if (m == 1) {
+    const void* hit = memchr(hay + pos, needle[0], n - pos);
+    return hit == nullptr ? NOT_FOUND : static_cast<const char*>(hit) - hay;
+  } else if (m <= SHORT_NEEDLE) {
+    found = find_short_forward(hay + pos, n - pos, needle, m);
+  } else {
+    found = two_way_search<false>(hay + pos, n - pos, needle, m);
+  }
+  return found == NOT_FOUND ? NOT_FOUND : found + pos;
+}
+
+// Last match starting at or before pos.
+size_t search_backward(const char* hay, size_t n, const char* needle, size_t m, size_t pos = NOT_FOUND) {
+  if (m > n) {
+    return NOT_FOUND;
+  }
+  if (pos < n - m) {
+    n = pos + m;
+  }
+  if (m == 0) {
+    return n;
+  }
+  if (m <= SHORT_NEEDLE) {
+    return find_short_backward(hay, n, needle, m);
+  }
+  return two_way_search<true>(hay, n, needle, m);
+}
+
+uint64_t read_u64(const char* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint64_t read_u32(const char* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// 64x64 -> 128 bit multiply folded back to 64 bits.
+uint64_t hash_mix(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t product = static_cast<__uint128_t>(a) * b;
+  return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+  uint64_t a_lo = a & 0xffffffffu, a_hi = a >> 32;
+  uint64_t b_lo = b & 0xffffffffu, b_hi = b >> 32;
+  uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+  uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffu) + lo_hi;
+  uint64_t low = (cross << 32) | (lo_lo & 0xffffffffu);
+  uint64_t high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+  return low ^ high;
+#endif
+}
+
+// wyhash-style hash. Inputs longer than 48 bytes are consumed 48 bytes per
+// step in three independent multiply lanes that run in parallel.
+uint64_t hash_bytes(const char* p, size_t len, uint64_t seed = 0) {
+  const uint64_t s0 = 0xa0761d6478bd642full;
+  const uint64_t s1 = 0xe7037ed1a0b428dbull;
+  const uint64_t s2 = 0x8ebc6af09c88c6e3ull;
+  const uint64_t s3 = 0x589965cc75374cc3ull;
+  seed ^= hash_mix(seed ^ s0, s1);
+  uint64_t a;
+  uint64_t b;
+  if (len <= 16) {
+    if (len >= 4) {
+      size_t shift = (len >> 3) << 2;
+      a = (read_u32(p) << 32) | read_u32(p + shift);
+      b = (read_u32(p + len - 4) << 32) | read_u32(p + len - 4 - shift);
+    } else if (len > 0) {
+      a = (static_cast<uint64_t>(static_cast<unsigned char>(p[0])) << 16) |
+          (static_cast<uint64_t>(static_cast<unsigned char>(p[len >> 1])) << 8) |
+          static_cast<unsigned char>(p[len - 1]);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t lane1 = seed;
+      uint64_t lane2 = seed;
+      do {
+        seed = hash_mix(read_u64(p) ^ s1, read_u64(p + 8) ^ seed);
+        lane1 = hash_mix(read_u64(p + 16) ^ s2, read_u64(p + 24) ^ lane1);
+        lane2 = hash_mix(read_u64(p + 32) ^ s3, read_u64(p + 40) ^ lane2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= lane1 ^ lane2;
+    }
+    while (i > 16) {
+      seed = hash_mix(read_u64(p) ^ s1, read_u64(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = read_u64(p + i - 16);
+    b = read_u64(p + i - 8);
+  }
+  return hash_mix(s1 ^ len, hash_mix(a ^ s1, b ^ seed));
+}
+
+class SplitRange;
+
+// Non-owning reference to size() chars; the referenced memory must outlive it.
+class StringView {
+public:
+  StringView(): data_(""), size_(0) {}
+
+  StringView(const char* ch): data_(ch), size_(strlen(ch)) {}
+
+  StringView(const char* ch, size_t sz): data_(ch), size_(sz) {}
+
+  const char& operator[](size_t n) const {
+    return data_[n];
+  }
+
+  const char* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  size_t length() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return (size_ == 0);
+  }
+
+  const char& front() const {
+    return data_[0];
+  }
+
+  const char& back() const {
+    return data_[size_ - 1];
+  }
+
+  StringView substr(size_t start, size_t count) const {
+    return StringView(data_ + start, count);
+  }
+
+  void remove_prefix(size_t n) {
+    data_ += n;
+    size_ -= n;
+  }
+
+  void remove_suffix(size_t n) {
+    size_ -= n;
+  }
+
+  size_t find(StringView substr, size_t pos = 0) const {
+    size_t found = search_forward(data_, size_, substr.data_, substr.size_, pos);
+    return found == NOT_FOUND ? size_ : found;
+  }
+
+  size_t rfind(StringView substr, size_t pos = NOT_FOUND) const {
+    size_t found = search_backward(data_, size_, substr.data_, substr.size_, pos);
+    return found == NOT_FOUND ? size_ : found;
+  }
+
+  SplitRange split(char delim) const;
+
+  // Lexicographic three-way comparison, like std::string_view::compare.
+  int compare(StringView s) const {
+    int result = memcmp(data_, s.data_, std::min(size_, s.size_));
+    if (result != 0) {
+      return result;
+    }
+    return size_ < s.size_ ? -1 : (size_ > s.size_ ? 1 : 0);
+  }
+
+private:
+  const char* data_;
+  size_t size_;
+};
+
+// Yields the pieces of a view between delimiters one at a time, without
+// allocating. "a,,b" splits into "a", "" and "b".
+class SplitRange {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = StringView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const StringView*;
+    using reference = const StringView&;
+
+    iterator(): delim_(0), has_more_(false), at_end_(true) {}
+
+    iterator(StringView source, char delim): rest_(source), delim_(delim), has_more_(true), at_end_(false) {
+      Next_();
+    }
+
+    const StringView& operator*() const {
+      return token_;
+    }
+
+    const StringView* operator->() const {
+      return &token_;
+    }
+
+    iterator& operator++() {
+      Next_();
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator copy = *this;
+      Next_();
+      return copy;
+    }
+
+    bool operator==(const iterator& other) const {
+      if (at_end_ || other.at_end_) {
+        return at_end_ == other.at_end_;
+      }
+      return token_.data() == other.token_.data();
+    }
+
+    bool operator!=(const iterator& other) const {
+      return !(*this == other);
+    }
+
+  private:
+    void Next_() {
+      if (!has_more_) {
+        at_end_ = true;
+        return;
+      }
+      const void* hit = memchr(rest_.data(), delim_, rest_.size());
+      if (hit == nullptr) {
+        token_ = rest_;
+        has_more_ = false;
+      } else {
+        size_t pos = static_cast<const char*>(hit) - rest_.data();
+        token_ = rest_.substr(0, pos);
+        rest_.remove_prefix(pos + 1);
+      }
+    }
+
+    StringView rest_;
+    StringView token_;
+    char delim_;
+    bool has_more_;
+    bool at_end_;
+  };
+
+  SplitRange(StringView source, char delim): source_(source), delim_(delim) {}
+
+  iterator begin() const {
+    return iterator(source_, delim_);
+  }
+
+  iterator end() const {
+    return iterator();
+  }
+
+private:
+  StringView source_;
+  char delim_;
+};
+
+SplitRange StringView::split(char delim) const {
+  return SplitRange(*this, delim);
+}
 
 class String {
 public:
-  String(const char* ch) : str_(new char[strlen(ch) + 1]), size_(strlen(ch)), capacity_(strlen(ch) + 1) {
-    memcpy(str_, ch, strlen(ch));
+  static constexpr int SMALL_CAPACITY = 24;
+  // Sizes are stored as int and the buffer also holds the terminator.
+  static constexpr size_t MAX_SIZE = INT_MAX - 1;
+
+  String(const char* ch, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : size_(CheckedSize_(strlen(ch))), resource_(resource), hash_(0) {
+    Allocate_(size_ + 1);
+    STRING_COUNT(bytes_copied, size_);
+    memcpy(str_, ch, size_);
     str_[size_] = '\0';
   }
 
-  String(int n, char ch) : str_(new char[n + 1]), size_(n), capacity_(n + 1) {
-    memset(str_, ch, n);
+  String(int n, char ch, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : size_(CheckedSize_(n)), resource_(resource), hash_(0) {
+    Allocate_(size_ + 1);
+    memset(str_, ch, size_);
     str_[size_] = '\0';
   }
 
-  String(char* str_new, int sz_new, int cap_new): str_(str_new), size_(sz_new), capacity_(cap_new) {}
+  explicit String(StringView s, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : size_(CheckedSize_(s.size())), resource_(resource), hash_(0) {
+    Allocate_(size_ + 1);
+    STRING_COUNT(bytes_copied, size_);
+    memcpy(str_, s.data(), size_);
+    str_[size_] = '\0';
+  }
+
+  String()
+      : str_(small_), size_(0), capacity_(SMALL_CAPACITY), resource_(std::pmr::get_default_resource()), hash_(0) {
+    str_[0] = '\0';
+  }
 
-  String(): str_(new char[2]), size_(0), capacity_(2) {
+  explicit String(std::pmr::memory_resource* resource)
+      : str_(small_), size_(0), capacity_(SMALL_CAPACITY), resource_(resource), hash_(0) {
     str_[0] = '\0';
   }
 
-  String(const String& s): String(s.size_, '0') {
+  // Like std::pmr::string, a copy does not inherit the source's resource.
+  String(const String& s, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : size_(s.size_), resource_(resource), hash_(s.hash_.load(std::memory_order_relaxed)) {
+    Allocate_(s.size_ + 1);
+    STRING_COUNT(bytes_copied, s.size_);
     memcpy(str_, s.str_, s.size_);
+    str_[size_] = '\0';
+  }
+
+  String(String&& s) noexcept: size_(s.size_), resource_(s.resource_), hash_(s.hash_.load(std::memory_order_relaxed)) {
+    Steal_(s);
   }
 
   ~String() {
-    delete[] str_;
+    Release_();
   }
 
   String& operator=(const String& s) &{
-    String copy = s;
+    if (this == &s) {
+      return *this;
+    }
+    if (s.size_ + 1 <= capacity_) {
+      STRING_COUNT(bytes_copied, s.size_);
+      memcpy(str_, s.str_, s.size_);
+      size_ = s.size_;
+      str_[size_] = '\0';
+      hash_.store(s.hash_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+    }
+    String copy(s, resource_);
     Swap_(copy);
-    str_[size_] = '\0';
     return *this;
   }
 
+  String& operator=(String&& s) & {
+    if (this == &s) {
+      return *this;
+    }
+    if (!resource_->is_equal(*s.resource_)) {
+      return *this = static_cast<const String&>(s);
+    }
+    Release_();
+    size_ = s.size_;
+    Steal_(s);
+    return *this;
+  }
+
+  std::pmr::memory_resource* resource() const {
+    return resource_;
+  }
+
   char& operator[](int n) {
+    ResetHash_();
     return *(str_ + n);
   }
 
@@ -43,29 +615,27 @@ public:
     return *(str_ + n);
   }
 
+  operator StringView() const {
+    return StringView(str_, size_);
+  }
+
   String substr(int start, int count) const {
-    int new_cap = 1;
-    while (capacity_ < count) {
-      new_cap *= 2;
-    }
-    char* new_str = new char[new_cap];
-    memcpy(new_str, str_ + start, count);
-    String result(new_str, count, new_cap);
+    String result(count, '\0', resource_);
+    STRING_COUNT(bytes_copied, count);
+    memcpy(result.str_, str_ + start, count);
     return result;
   }
 
-  String& operator+=(const String& s) {
-    int new_size = size_ + s.size();
-    while(capacity_ < new_size + 1) {
-      capacity_ *= 2;
-    }
-    char* new_str = new char[capacity_];
-    memcpy(new_str, str_, size_);
-    memcpy(new_str + size_, s.str_, s.size());
-    new_str[new_size] = '\0';
-    delete[] str_;
-    str_ = new_str;
-    size_ = new_size;
+  StringView substr_view(int start, int count) const {
+    return StringView(str_ + start, count);
+  }
+
+  SplitRange split(char delim) const {
+    return SplitRange(*this, delim);
+  }
+
+  String& operator+=(StringView s) {
+    Append_(s.data(), s.size());
     return *this;
   }
   
@@ -86,28 +656,47 @@ public:
     return capacity_;
   }
 
+  void reserve(size_t new_cap) {
+    int count = CheckedSize_(new_cap);
+    if (count + 1 > capacity_) {
+      Reallocate_(count + 1);
+    }
+  }
+
+  void resize(size_t new_size, char ch = '\0') {
+    ResetHash_();
+    int count = CheckedSize_(new_size);
+    if (count > size_) {
+      if (count + 1 > capacity_) {
+        Reallocate_(GrownCapacity_(count));
+      }
+      memset(str_ + size_, ch, count - size_);
+    }
+    size_ = count;
+    str_[size_] = '\0';
+  }
+
   void push_back(char ch) {
+    ResetHash_();
     if (size_ + 1 < capacity_) {
       str_[size_] = ch;
       str_[size_ + 1] = '\0';
     } else {
-      capacity_ *= 2;
-      char* temp_str = new char[capacity_];
-      memcpy(temp_str, str_, size_);
-      temp_str[size_] = ch;
-      delete[] str_;
-      str_ = temp_str;
+      Reallocate_(GrownCapacity_(static_cast<size_t>(size_) + 1));
+      str_[size_] = ch;
       str_[size_ + 1] = '\0';
     }
     ++size_;   
   }
 
   void pop_back() {
+    ResetHash_();
     str_[size_ - 1] = '\0';
     --size_;
   }
 
   char& front() {
+    ResetHash_();
     return str_[0];
   }
 
@@ -116,6 +705,7 @@ public:
   }
 
   char& back() {
+    ResetHash_();
     if (size_ == 0) {
       return str_[0];
     }
@@ -129,148 +719,1249 @@ public:
     return str_[size_ - 1];
   }
 
-  size_t find(const String& substr) const {
-    for (size_t i = 0; i <= static_cast<size_t>(size_) - substr.size(); ++i) {
-      if (str_[i] == substr[0]) {
-        size_t compare_index = 0;
-        bool is_substr = true;
-        while (compare_index < substr.size()) {
-          if (str_[i + compare_index] != substr[compare_index]) {
-            is_substr = false;
-            break;
-          }
-          ++compare_index;
-        }
-        if (is_substr) {
-          return i;
-        }
-      }
-    }
-    return size_;
+  size_t find(StringView substr, size_t pos = 0) const {
+    size_t found = search_forward(str_, size_, substr.data(), substr.size(), pos);
+    return found == NOT_FOUND ? size_ : found;
   }
 
-  size_t rfind(const String& substr) const {
-    int ans = size_;
-    for (size_t i = 0; i <= static_cast<size_t>(size_) - substr.size(); ++i) {
-      if (str_[i] == substr[0]) {
-        size_t compare_index = 0;
-        bool is_substr = true;
-        while (compare_index < substr.size()) {
-          if (str_[i + compare_index] != substr[compare_index]) {
-            is_substr = false;
-            break;
-          }
-          ++compare_index;
-        }
-        if (is_substr) {
-          ans = static_cast<int>(i);
-        }
-      }
-    }
-    return ans;
+  size_t rfind(StringView substr, size_t pos = NOT_FOUND) const {
+    size_t found = search_backward(str_, size_, substr.data(), substr.size(), pos);
+    return found == NOT_FOUND ? size_ : found;
   }
-  
+
   bool empty() const {
     return (size_ == 0);
   }
 
   void clear() {
+    ResetHash_();
     size_ = 0;
     str_[0] = '\0';
   }
 
   void shrink_to_fit() {
-    char* new_str = new char[size_];
-    memcpy(new_str, str_, size_);
-    delete[] str_;
-    str_ = new_str;
-    capacity_ = size_;
+    if (IsSmall_()) {
+      return;
+    }
+    Reallocate_(size_ + 1);
   }
 
-  char* data() const {
+  char* data() {
+    ResetHash_();
     return str_;
   }
 
+  const char* data() const {
+    return str_;
+  }
+
+  // Cached until the next mutation. A char reference or data() pointer kept
+  // from before hash() and written through afterwards leaves it stale.
+  // Safe to call from several threads on a shared const String: racing
+  // callers compute the same value and the cache is a relaxed atomic.
+  size_t hash() const {
+    size_t hash = hash_.load(std::memory_order_relaxed);
+    if (hash == 0) {
+      hash = hash_bytes(str_, size_);
+      if (hash == 0) {
+        hash = 1;
+      }
+      hash_.store(hash, std::memory_order_relaxed);
+    }
+    return hash;
+  }
+
+  int compare(StringView s) const {
+    return StringView(*this).compare(s);
+  }
+
 private:
+  bool IsSmall_() const {
+    return str_ == small_;
+  }
+
+  static int CheckedSize_(size_t n) {
+    if (n > MAX_SIZE) {
+      throw std::length_error("String: size exceeds MAX_SIZE");
+    }
+    return static_cast<int>(n);
+  }
+
+  static int CheckedSize_(int n) {
+    if (n < 0) {
+      throw std::length_error("String: negative size");
+    }
+    return CheckedSize_(static_cast<size_t>(n));
+  }
+
+  // Buffer size for at least new_size chars: double the current capacity,
+  // saturating at INT_MAX instead of overflowing.
+  int GrownCapacity_(size_t new_size) const {
+    size_t needed = static_cast<size_t>(CheckedSize_(new_size)) + 1;
+    size_t doubled = std::min<size_t>(static_cast<size_t>(capacity_) * 2, INT_MAX);
+    return static_cast<int>(std::max(needed, doubled));
+  }
+
+  // Points str_ at the inline buffer when cap fits, otherwise at a block
+  // taken from resource_.
+  void Allocate_(int cap) {
+    if (cap <= SMALL_CAPACITY) {
+      str_ = small_;
+      capacity_ = SMALL_CAPACITY;
+    } else {
+      STRING_COUNT(allocations, 1);
+      str_ = static_cast<char*>(resource_->allocate(cap, 1));
+      capacity_ = cap;
+    }
+  }
+
+  void Deallocate_(char* ptr, int cap) {
+    if (ptr != small_) {
+      resource_->deallocate(ptr, cap, 1);
+    }
+  }
+
+  void Release_() {
+    Deallocate_(str_, capacity_);
+  }
+
+  void Reallocate_(int cap) {
+    char* old_str = str_;
+    int old_cap = capacity_;
+    if (cap <= SMALL_CAPACITY && IsSmall_()) {
+      return;
+    }
+    STRING_COUNT(reallocations, 1);
+    Allocate_(cap);
+    if (str_ != old_str) {
+      STRING_COUNT(bytes_copied, size_);
+      memcpy(str_, old_str, size_ + 1);
+    }
+    Deallocate_(old_str, old_cap);
+  }
+
+  // Takes over the buffer of s (size_ is already set) and leaves s empty.
+  void Steal_(String& s) {
+    if (s.IsSmall_()) {
+      str_ = small_;
+      capacity_ = SMALL_CAPACITY;
+      STRING_COUNT(bytes_copied, size_);
+      memcpy(small_, s.small_, size_ + 1);
+    } else {
+      str_ = s.str_;
+      capacity_ = s.capacity_;
+    }
+    s.str_ = s.small_;
+    s.size_ = 0;
+    s.capacity_ = SMALL_CAPACITY;
+    s.small_[0] = '\0';
+    hash_.store(s.hash_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    s.ResetHash_();
+  }
+
+  // src may point into this string: the old buffer is freed only after copying.
+  void Append_(const char* src, size_t count) {
+    ResetHash_();
+    int new_size = CheckedSize_(size_ + count);
+    if (new_size + 1 <= capacity_) {
+      STRING_COUNT(bytes_copied, count);
+      memmove(str_ + size_, src, count);
+    } else {
+      int new_cap = GrownCapacity_(new_size);
+      char* old_str = str_;
+      int old_cap = capacity_;
+      STRING_COUNT(reallocations, 1);
+      Allocate_(new_cap);
+      STRING_COUNT(bytes_copied, size_ + count);
+      memcpy(str_, old_str, size_);
+      memcpy(str_ + size_, src, count);
+      Deallocate_(old_str, old_cap);
+    }
+    size_ = new_size;
+    str_[size_] = '\0';
+  }
+
   void Swap_(String& s) {
+    bool this_small = IsSmall_();
+    bool other_small = s.IsSmall_();
+    char* this_str = str_;
+    char* other_str = s.str_;
+    char small_copy[SMALL_CAPACITY];
+    memcpy(small_copy, small_, SMALL_CAPACITY);
+    memcpy(small_, s.small_, SMALL_CAPACITY);
+    memcpy(s.small_, small_copy, SMALL_CAPACITY);
+    str_ = other_small ? small_ : other_str;
+    s.str_ = this_small ? s.small_ : this_str;
     std::swap(capacity_, s.capacity_);
     std::swap(size_, s.size_);
-    std::swap(str_, s.str_);
+    std::swap(resource_, s.resource_);
+    size_t hash = hash_.load(std::memory_order_relaxed);
+    hash_.store(s.hash_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    s.hash_.store(hash, std::memory_order_relaxed);
+  }
+
+  void ResetHash_() {
+    hash_.store(0, std::memory_order_relaxed);
   }
+
   char* str_;
   int size_;
   int capacity_;
+  std::pmr::memory_resource* resource_;
+  mutable std::atomic<size_t> hash_;
+  char small_[SMALL_CAPACITY];
+};
+
+// Bump allocator for the Strings of one request. Pass resource() to their
+// constructors; release() then frees all of them at once and rewinds to the
+// arena's own block, so the next request reuses it without touching the
+// global heap. Not thread-safe: keep one arena per worker thread, and do not
+// use a String from the arena after release().
+class RequestArena {
+public:
+  explicit RequestArena(size_t block_size = 64 * 1024)
+      : block_(new char[block_size]), arena_(block_.get(), block_size) {}
+
+  RequestArena(const RequestArena&) = delete;
+  RequestArena& operator=(const RequestArena&) = delete;
+
+  std::pmr::memory_resource* resource() {
+    return &arena_;
+  }
+
+  void release() {
+    arena_.release();
+  }
+
+private:
+  std::unique_ptr<char[]> block_;
+  std::pmr::monotonic_buffer_resource arena_;
 };
 
-bool operator==(const String& s1, const String& s2) {
+bool operator==(StringView s1, StringView s2) {
   if (s1.size() != s2.size()) {
     return false;
   }
-  if (memcmp(&(s1[0]), &(s2[0]), s1.size()) == 0) { return true; }
+  if (memcmp(s1.data(), s2.data(), s1.size()) == 0) { return true; }
   return false;
 }
   
-bool operator!=(const String& s1, const String& s2) {
+bool operator!=(StringView s1, StringView s2) {
   return !(s1 == s2);
 }
 
-bool operator<(const String& s1, const String& s2) {
+// Orders by length first; use compare or LexicographicLess for dictionary order.
+bool operator<(StringView s1, StringView s2) {
   if (s1.size() != s2.size()) { return s1.size() < s2.size(); }
-  if (memcmp(&(s1[0]), &(s2[0]), s1.size()) < 0) { return true; }
+  if (memcmp(s1.data(), s2.data(), s1.size()) < 0) { return true; }
   return false;
 }
 
-bool operator>(const String& s1, const String& s2) {
+bool operator>(StringView s1, StringView s2) {
   return (s2 < s1);
 }
 
-bool operator<=(const String& s1, const String& s2) {
+bool operator<=(StringView s1, StringView s2) {
   return !(s1 > s2);
 }
 
-bool operator>=(const String& s1, const String& s2) {
+bool operator>=(StringView s1, StringView s2) {
   return !(s1 < s2);
 }
 
-String operator+(const String& s1, const String& s2) {
-  int new_cap = std::max(s1.capacity(), s2.capacity());
-  int new_size = s1.size() + s2.size();
-  while (new_cap < new_size + 1) {
-    new_cap *= 2;
-  }
-  char* new_str = new char[new_cap];
-  memcpy(new_str, s1.data(), s1.size());
-  memcpy(new_str + s1.size(), s2.data(), s2.size());
-  new_str[new_size] = '\0';
-  String result(new_str, new_size, new_cap);
+struct LexicographicLess {
+  bool operator()(StringView s1, StringView s2) const {
+    return s1.compare(s2) < 0;
+  }
+};
+
+namespace std {
+template <>
+struct hash<StringView> {
+  size_t operator()(StringView s) const {
+    return hash_bytes(s.data(), s.size());
+  }
+};
+
+template <>
+struct hash<String> {
+  size_t operator()(const String& s) const {
+    return s.hash();
+  }
+};
+}
+
+class StringPool;
+
+// Handle to a String owned by a StringPool. Equal contents intern to the
+// same String, so equality and hashing only look at the pointer.
+class InternedString {
+public:
+  const String& str() const {
+    return *str_;
+  }
+
+  operator StringView() const {
+    return *str_;
+  }
+
+  size_t hash() const {
+    return str_->hash();
+  }
+
+  bool operator==(const InternedString& other) const {
+    return str_ == other.str_;
+  }
+
+  bool operator!=(const InternedString& other) const {
+    return str_ != other.str_;
+  }
+
+private:
+  friend class StringPool;
+
+  explicit InternedString(const String* str): str_(str) {}
+
+  const String* str_;
+};
+
+namespace std {
+template <>
+struct hash<InternedString> {
+  size_t operator()(const InternedString& s) const {
+    return s.hash();
+  }
+};
+}
+
+// Stores one copy of each distinct string. Handles stay valid for the
+// lifetime of the pool.
+class StringPool {
+public:
+  InternedString intern(StringView s) {
+    auto it = table_.find(s);
+    if (it != table_.end()) {
+      return InternedString(it->second.get());
+    }
+    std::unique_ptr<String> owned(new String(s));
+    owned->hash();
+    const String* str = owned.get();
+    table_.emplace(StringView(*str), std::move(owned));
+    return InternedString(str);
+  }
+
+  size_t size() const {
+    return table_.size();
+  }
+
+private:
+  std::unordered_map<StringView, std::unique_ptr<String>> table_;
+};
+
+// Results that need a new buffer take it from the left operand's resource.
+String operator+(const String& s1, const String& s2) {
+  String result(s1.size() + s2.size(), '\0', s1.resource());
+  STRING_COUNT(bytes_copied, s1.size() + s2.size());
+  memcpy(result.data(), s1.data(), s1.size());
+  memcpy(result.data() + s1.size(), s2.data(), s2.size());
   return result;
 }
 
+String operator+(String&& s1, const String& s2) {
+  s1 += s2;
+  return std::move(s1);
+}
+
+String operator+(const String& s1, String&& s2) {
+  if (&s1 == &s2 || s2.size() + s1.size() + 1 > s2.capacity()) {
+    return s1 + static_cast<const String&>(s2);
+  }
+  size_t prefix = s1.size();
+  size_t old_size = s2.size();
+  s2.resize(old_size + prefix);
+  STRING_COUNT(bytes_copied, old_size + prefix);
+  memmove(s2.data() + prefix, s2.data(), old_size);
+  memcpy(s2.data(), s1.data(), prefix);
+  return std::move(s2);
+}
+
+String operator+(String&& s1, String&& s2) {
+  s1 += s2;
+  return std::move(s1);
+}
+
 String operator+(const String& s1, char ch2) {
-  String result = s1;
+  String result(s1.resource());
+  result.reserve(s1.size() + 1);
+  result += s1;
   result.push_back(ch2);
   return result;
 }
 
+String operator+(String&& s1, char ch2) {
+  s1.push_back(ch2);
+  return std::move(s1);
+}
+
 String operator+(char ch1, const String& s2) {
-  String result;
+  String result(s2.resource());
+  result.reserve(s2.size() + 1);
   result.push_back(ch1);
   result += s2;
   return result;
 }
 
-std::ostream& operator<<(std::ostream& out, const String& s) {
-  for (size_t i = 0; i < s.size(); ++i) {
-    out << s[i];
+String operator+(char ch1, String&& s2) {
+  if (s2.size() + 2 > s2.capacity()) {
+    return ch1 + static_cast<const String&>(s2);
+  }
+  size_t old_size = s2.size();
+  s2.resize(old_size + 1);
+  STRING_COUNT(bytes_copied, old_size);
+  char* data = s2.data();
+  memmove(data + 1, data, old_size);
+  data[0] = ch1;
+  return std::move(s2);
+}
+
+// Builds a large String out of many pieces. The text is kept as a list of
+// fragments of at most FRAGMENT_SIZE chars, so appends never move earlier
+// text and insert/erase in the middle only touch one or two fragments.
+// A Fenwick tree over the fragment sizes finds the fragment holding a
+// position in O(log fragments). flatten() copies everything into a single
+// exactly sized String.
+class StringBuilder {
+public:
+  static constexpr size_t FRAGMENT_SIZE = 1 << 16;
+
+  explicit StringBuilder(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : size_(0), resource_(resource), tree_(1, 0) {}
+
+  StringBuilder& append(StringView s) {
+    while (!s.empty()) {
+      if (fragments_.empty() || fragments_.back().size() == FRAGMENT_SIZE) {
+        fragments_.emplace_back(resource_);
+        size_t node = fragments_.size();
+        tree_.push_back(Prefix_(node - 1) - Prefix_(node - (node & -node)));
+      }
+      String& last = fragments_.back();
+      size_t count = std::min(s.size(), FRAGMENT_SIZE - last.size());
+      if (last.capacity() < last.size() + count + 1) {
+        last.reserve(std::min(FRAGMENT_SIZE, std::max(last.size() + count, 2 * last.capacity())));
+      }
+      last += s.substr(0, count);
+      s.remove_prefix(count);
+      size_ += count;
+      Add_(fragments_.size() - 1, count);
+    }
+    return *this;
+  }
+
+  StringBuilder& append(char ch) {
+    return append(StringView(&ch, 1));
+  }
+
+  StringBuilder& operator+=(StringView s) {
+    return append(s);
+  }
+
+  StringBuilder& operator+=(char ch) {
+    return append(ch);
+  }
+
+  // Positions past the end append; an empty s is a no-op.
+  void insert(size_t pos, StringView s) {
+    if (s.empty()) {
+      return;
+    }
+    if (pos >= size_) {
+      append(s);
+      return;
+    }
+    size_t index = Locate_(pos);
+    String& fragment = fragments_[index];
+    if (fragment.size() + s.size() <= FRAGMENT_SIZE) {
+      size_t old_size = fragment.size();
+      fragment.resize(old_size + s.size());
+      char* data = fragment.data();
+      STRING_COUNT(bytes_copied, old_size - pos + s.size());
+      memmove(data + pos + s.size(), data + pos, old_size - pos);
+      memcpy(data + pos, s.data(), s.size());
+      size_ += s.size();
+      Add_(index, s.size());
+      return;
+    }
+    std::vector<String> pieces;
+    pieces.emplace_back(fragment.substr_view(pos, fragment.size() - pos), resource_);
+    fragment.resize(pos);
+    while (!s.empty()) {
+      size_t count = std::min(s.size(), FRAGMENT_SIZE);
+      pieces.emplace_back(s.substr(0, count), resource_);
+      s.remove_prefix(count);
+      size_ += count;
+    }
+    std::rotate(pieces.begin(), pieces.begin() + 1, pieces.end());
+    fragments_.insert(fragments_.begin() + index + 1,
+                      std::make_move_iterator(pieces.begin()), std::make_move_iterator(pieces.end()));
+    if (fragments_[index].empty()) {
+      fragments_.erase(fragments_.begin() + index);
+    }
+    Rebuild_();
+  }
+
+  // Erases at most count chars; nothing happens when pos is at or past the end.
+  void erase(size_t pos, size_t count) {
+    if (pos >= size_) {
+      return;
+    }
+    count = std::min(count, size_ - pos);
+    if (count == 0) {
+      return;
+    }
+    size_ -= count;
+    size_t index = Locate_(pos);
+    size_t first_empty = fragments_.size();
+    size_t last_empty = index;
+    while (count > 0) {
+      String& fragment = fragments_[index];
+      size_t removed = std::min(count, fragment.size() - pos);
+      char* data = fragment.data();
+      STRING_COUNT(bytes_copied, fragment.size() - pos - removed);
+      memmove(data + pos, data + pos + removed, fragment.size() - pos - removed);
+      fragment.resize(fragment.size() - removed);
+      Add_(index, -removed);
+      if (fragment.empty()) {
+        first_empty = std::min(first_empty, index);
+        last_empty = index + 1;
+      }
+      count -= removed;
+      pos = 0;
+      ++index;
+    }
+    if (first_empty < last_empty) {
+      fragments_.erase(fragments_.begin() + first_empty, fragments_.begin() + last_empty);
+      Rebuild_();
+    }
+  }
+
+  char operator[](size_t pos) const {
+    if (pos >= size_) {
+      return '\0';
+    }
+    size_t index = Locate_(pos);
+    return fragments_[index][pos];
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return (size_ == 0);
+  }
+
+  void clear() {
+    fragments_.clear();
+    tree_.assign(1, 0);
+    size_ = 0;
+  }
+
+  String flatten() const {
+    String result(resource_);
+    result.reserve(size_);
+    for (const String& fragment : fragments_) {
+      result += fragment;
+    }
+    return result;
+  }
+
+private:
+  // Returns the fragment holding pos < size() and rewrites pos as an offset
+  // into it.
+  size_t Locate_(size_t& pos) const {
+    size_t step = 1;
+    while (2 * step < tree_.size()) {
+      step *= 2;
+    }
+    size_t index = 0;
+    for (; step > 0; step /= 2) {
+      if (index + step < tree_.size() && tree_[index + step] <= pos) {
+        index += step;
+        pos -= tree_[index];
+      }
+    }
+    return index;
+  }
+
+  // Sum of the sizes of the first count fragments.
+  size_t Prefix_(size_t count) const {
+    size_t sum = 0;
+    for (; count > 0; count -= count & -count) {
+      sum += tree_[count];
+    }
+    return sum;
+  }
+
+  // delta may be a negated size; the unsigned sums wrap back into range.
+  void Add_(size_t index, size_t delta) {
+    for (size_t node = index + 1; node < tree_.size(); node += node & -node) {
+      tree_[node] += delta;
+    }
+  }
+
+  void Rebuild_() {
+    tree_.assign(fragments_.size() + 1, 0);
+    for (size_t node = 1; node < tree_.size(); ++node) {
+      tree_[node] += fragments_[node - 1].size();
+      size_t parent = node + (node & -node);
+      if (parent < tree_.size()) {
+        tree_[parent] += tree_[node];
+      }
+    }
+  }
+
+  std::vector<String> fragments_;
+  size_t size_;
+  std::pmr::memory_resource* resource_;
+  // Fenwick tree: tree_[node] sums the sizes of fragments
+  // [node - (node & -node), node).
+  std::vector<size_t> tree_;
+};
+
+struct PatternMatch {
+  size_t pattern;
+  size_t offset;
+};
+
+// Aho-Corasick automaton over a set of patterns. Bytes that occur in no
+// pattern share one input class, and the transition table is a single
+// states x classes array, so each input byte costs two table lookups.
+// Empty patterns are ignored.
+class MultiPatternMatcher {
+public:
+  MultiPatternMatcher(): compiled_(false) {
+    compile();
+  }
+
+  explicit MultiPatternMatcher(const std::vector<StringView>& patterns): MultiPatternMatcher() {
+    for (StringView pattern : patterns) {
+      add(pattern);
+    }
+    compile();
+  }
+
+  // Pattern ids are assigned in order of addition. compile() must be called
+  // after the last add() and before matching; scanning a matcher with
+  // uncompiled patterns throws std::logic_error.
+  size_t add(StringView pattern) {
+    patterns_.emplace_back(pattern);
+    compiled_ = false;
+    return patterns_.size() - 1;
+  }
+
+  bool compiled() const {
+    return compiled_;
+  }
+
+  void compile() {
+    memset(classes_, 0, sizeof(classes_));
+    num_classes_ = 1;
+    for (const String& pattern : patterns_) {
+      for (size_t i = 0; i < pattern.size(); ++i) {
+        unsigned char byte = pattern[i];
+        if (classes_[byte] == 0) {
+          classes_[byte] = num_classes_++;
+        }
+      }
+    }
+
+    transitions_.assign(num_classes_, -1);
+    std::vector<std::vector<size_t>> outputs(1);
+    for (size_t id = 0; id < patterns_.size(); ++id) {
+      const String& pattern = patterns_[id];
+      if (pattern.empty()) {
+        continue;
+      }
+      int32_t state = 0;
+      for (size_t i = 0; i < pattern.size(); ++i) {
+        int32_t& next = transitions_[state * num_classes_ + classes_[static_cast<unsigned char>(pattern[i])]];
+        if (next == -1) {
+          next = static_cast<int32_t>(outputs.size());
+          outputs.emplace_back();
+          transitions_.resize(transitions_.size() + num_classes_, -1);
+        }
+        state = transitions_[state * num_classes_ + classes_[static_cast<unsigned char>(pattern[i])]];
+      }
+      outputs[state].push_back(id);
+    }
+
+    size_t num_states = outputs.size();
+    std::vector<int32_t> fail(num_states, 0);
+    std::vector<int32_t> output_link(num_states, -1);
+    std::vector<int32_t> queue;
+    queue.reserve(num_states);
+    for (size_t c = 0; c < num_classes_; ++c) {
+      int32_t& next = transitions_[c];
+      if (next == -1) {
+        next = 0;
+      } else {
+        queue.push_back(next);
+      }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+      int32_t state = queue[head];
+      int32_t suffix = fail[state];
+      output_link[state] = outputs[suffix].empty() ? output_link[suffix] : suffix;
+      for (size_t c = 0; c < num_classes_; ++c) {
+        int32_t& next = transitions_[state * num_classes_ + c];
+        int32_t fallback = transitions_[suffix * num_classes_ + c];
+        if (next == -1) {
+          next = fallback;
+        } else {
+          fail[next] = fallback;
+          queue.push_back(next);
+        }
+      }
+    }
+
+    // Flatten every state's reportable ids (its own plus those reachable
+    // through output links) into one array so a hit is a contiguous read.
+    output_start_.assign(num_states + 1, 0);
+    output_ids_.clear();
+    for (size_t state = 0; state < num_states; ++state) {
+      output_start_[state] = output_ids_.size();
+      for (int32_t t = outputs[state].empty() ? output_link[state] : static_cast<int32_t>(state); t != -1;
+           t = output_link[t]) {
+        output_ids_.insert(output_ids_.end(), outputs[t].begin(), outputs[t].end());
+      }
+    }
+    output_start_[num_states] = output_ids_.size();
+    compiled_ = true;
+  }
+
+  size_t pattern_count() const {
+    return patterns_.size();
+  }
+
+  const String& pattern(size_t id) const {
+    return patterns_[id];
+  }
+
+  // Calls on_match(PatternMatch) for every occurrence, ordered by end offset.
+  template <typename Callback>
+  void scan(StringView text, Callback on_match) const {
+    Scan_(0, text, 0, on_match);
+  }
+
+  std::vector<PatternMatch> find_all(StringView text) const {
+    std::vector<PatternMatch> matches;
+    scan(text, [&matches](const PatternMatch& match) { matches.push_back(match); });
+    return matches;
+  }
+
+  // Matches input that arrives in chunks; occurrences spanning chunk
+  // boundaries are reported with offsets relative to the whole stream.
+  class Stream {
+  public:
+    explicit Stream(const MultiPatternMatcher& matcher): matcher_(&matcher), state_(0), consumed_(0) {
+      matcher.CheckCompiled_();
+    }
+
+    template <typename Callback>
+    void feed(StringView chunk, Callback on_match) {
+      state_ = matcher_->Scan_(state_, chunk, consumed_, on_match);
+      consumed_ += chunk.size();
+    }
+
+    size_t consumed() const {
+      return consumed_;
+    }
+
+    void reset() {
+      state_ = 0;
+      consumed_ = 0;
+    }
+
+  private:
+    const MultiPatternMatcher* matcher_;
+    int32_t state_;
+    size_t consumed_;
+  };
+
+  Stream stream() const {
+    return Stream(*this);
+  }
+
+private:
+  void CheckCompiled_() const {
+    if (!compiled_) {
+      throw std::logic_error("MultiPatternMatcher: add() without compile()");
+    }
+  }
+
+  template <typename Callback>
+  int32_t Scan_(int32_t state, StringView text, size_t base, Callback& on_match) const {
+    CheckCompiled_();
+    const int32_t* transitions = transitions_.data();
+    const size_t* output_start = output_start_.data();
+    for (size_t i = 0; i < text.size(); ++i) {
+      state = transitions[state * num_classes_ + classes_[static_cast<unsigned char>(text[i])]];
+      size_t first = output_start[state];
+      size_t last = output_start[state + 1];
+      for (size_t k = first; k < last; ++k) {
+        size_t id = output_ids_[k];
+        on_match(PatternMatch{id, base + i + 1 - patterns_[id].size()});
+      }
+    }
+    return state;
+  }
+
+  std::vector<String> patterns_;
+  uint16_t classes_[256];
+  size_t num_classes_;
+  std::vector<int32_t> transitions_;
+  std::vector<size_t> output_start_;
+  std::vector<size_t> output_ids_;
+  bool compiled_;
+};
+
+// Fixed set of worker threads. parallel_for runs its body on the workers and
+// on the calling thread, and returns once every index has been processed.
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threads = std::max(1u, std::thread::hardware_concurrency())): stopping_(false) {
+    for (size_t i = 1; i < threads; ++i) {
+      workers_.emplace_back([this] { WorkerLoop_(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_all();
+    for (std::thread& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  // Number of threads taking part in parallel_for, the caller included.
+  size_t size() const {
+    return workers_.size() + 1;
+  }
+
+  template <typename F>
+  void parallel_for(size_t count, F body) {
+    std::atomic<size_t> next(0);
+    auto drain = [&next, count, &body] {
+      for (size_t i = next++; i < count; i = next++) {
+        body(i);
+      }
+    };
+    size_t helpers = std::min(workers_.size(), count > 0 ? count - 1 : 0);
+    size_t finished = 0;
+    std::mutex finished_mutex;
+    std::condition_variable all_finished;
+    for (size_t i = 0; i < helpers; ++i) {
+      Submit_([&] {
+        drain();
+        std::lock_guard<std::mutex> lock(finished_mutex);
+        if (++finished == helpers) {
+          all_finished.notify_one();
+        }
+      });
+    }
+    drain();
+    std::unique_lock<std::mutex> lock(finished_mutex);
+    all_finished.wait(lock, [&] { return finished == helpers; });
+  }
+
+private:
+  void Submit_(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    ready_.notify_one();
+  }
+
+  void WorkerLoop_() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_;
+};
+
+ThreadPool& default_thread_pool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+// Inputs below this size are searched serially.
+const size_t PARALLEL_CUTOFF = 1 << 20;
+const size_t PARALLEL_MIN_CHUNK = 1 << 18;
+
+// Number of (possibly overlapping) occurrences of needle in hay.
+size_t count_occurrences(StringView hay, StringView needle) {
+  if (needle.empty()) {
+    return hay.size() + 1;
+  }
+  size_t result = 0;
+  for (size_t pos = search_forward(hay.data(), hay.size(), needle.data(), needle.size()); pos != NOT_FOUND;
+       pos = search_forward(hay.data(), hay.size(), needle.data(), needle.size(), pos + 1)) {
+    ++result;
+  }
+  return result;
+}
+
+// Splits the candidate start positions of hay into chunks. Chunk i owns the
+// starts [i * chunk, (i + 1) * chunk) and is handed a view extended by
+// needle.size() - 1 chars, so matches crossing a chunk border are seen by
+// exactly one chunk.
+struct ParallelChunks {
+  ParallelChunks(StringView hay, StringView needle, const ThreadPool& pool)
+      : hay_(hay), needle_(needle) {
+    size_t starts = hay.size() - needle.size() + 1;
+    chunk_ = std::max(PARALLEL_MIN_CHUNK, starts / (pool.size() * 4) + 1);
+    count_ = (starts + chunk_ - 1) / chunk_;
+  }
+
+  size_t begin(size_t i) const {
+    return i * chunk_;
+  }
+
+  StringView view(size_t i) const {
+    size_t first = begin(i);
+    size_t last = std::min(hay_.size(), first + chunk_ + needle_.size() - 1);
+    return hay_.substr(first, last - first);
+  }
+
+  StringView hay_;
+  StringView needle_;
+  size_t chunk_;
+  size_t count_;
+};
+
+bool run_serially(StringView hay, StringView needle, const ThreadPool& pool) {
+  return hay.size() < PARALLEL_CUTOFF || pool.size() == 1 || needle.empty() || needle.size() > hay.size();
+}
+
+// Like StringView::find: returns hay.size() when there is no match. Chunks
+// are claimed in order and skipped once an earlier match is known.
+size_t par_find(StringView hay, StringView needle, ThreadPool& pool = default_thread_pool()) {
+  if (run_serially(hay, needle, pool)) {
+    return hay.find(needle);
+  }
+  ParallelChunks chunks(hay, needle, pool);
+  std::atomic<size_t> best(NOT_FOUND);
+  pool.parallel_for(chunks.count_, [&](size_t i) {
+    if (best.load(std::memory_order_relaxed) < chunks.begin(i)) {
+      return;
+    }
+    StringView part = chunks.view(i);
+    size_t found = search_forward(part.data(), part.size(), needle.data(), needle.size());
+    if (found == NOT_FOUND) {
+      return;
+    }
+    found += chunks.begin(i);
+    size_t current = best.load();
+    while (found < current && !best.compare_exchange_weak(current, found)) {}
+  });
+  return best == NOT_FOUND ? hay.size() : best.load();
+}
+
+size_t par_rfind(StringView hay, StringView needle, ThreadPool& pool = default_thread_pool()) {
+  if (run_serially(hay, needle, pool)) {
+    return hay.rfind(needle);
+  }
+  ParallelChunks chunks(hay, needle, pool);
+  std::atomic<size_t> best(NOT_FOUND);
+  pool.parallel_for(chunks.count_, [&](size_t j) {
+    size_t i = chunks.count_ - 1 - j;
+    size_t current = best.load(std::memory_order_relaxed);
+    if (current != NOT_FOUND && current >= chunks.begin(i + 1)) {
+      return;
+    }
+    StringView part = chunks.view(i);
+    size_t found = search_backward(part.data(), part.size(), needle.data(), needle.size());
+    if (found == NOT_FOUND) {
+      return;
+    }
+    found += chunks.begin(i);
+    current = best.load();
+    while ((current == NOT_FOUND || found > current) && !best.compare_exchange_weak(current, found)) {}
+  });
+  return best == NOT_FOUND ? hay.size() : best.load();
+}
+
+size_t par_count(StringView hay, StringView needle, ThreadPool& pool = default_thread_pool()) {
+  if (run_serially(hay, needle, pool)) {
+    return count_occurrences(hay, needle);
+  }
+  ParallelChunks chunks(hay, needle, pool);
+  std::atomic<size_t> total(0);
+  pool.parallel_for(chunks.count_, [&](size_t i) {
+    total += count_occurrences(chunks.view(i), needle);
+  });
+  return total;
+}
+
+bool write_fill(std::streambuf* buf, char fill, std::streamsize count) {
+  char chunk[64];
+  memset(chunk, fill, sizeof(chunk));
+  while (count > 0) {
+    std::streamsize part = std::min<std::streamsize>(count, sizeof(chunk));
+    if (buf->sputn(chunk, part) != part) {
+      return false;
+    }
+    count -= part;
+  }
+  return true;
+}
+
+// Honors width() and fill() like the std::string inserter and resets width.
+std::ostream& operator<<(std::ostream& out, StringView s) {
+  std::ostream::sentry sentry(out);
+  if (sentry) {
+    std::streambuf* buf = out.rdbuf();
+    std::streamsize count = static_cast<std::streamsize>(s.size());
+    std::streamsize padding = out.width() > count ? out.width() - count : 0;
+    bool left = (out.flags() & std::ios_base::adjustfield) == std::ios_base::left;
+    bool ok = (left || write_fill(buf, out.fill(), padding)) && buf->sputn(s.data(), count) == count &&
+              (!left || write_fill(buf, out.fill(), padding));
+    if (!ok) {
+      out.setstate(std::ios_base::badbit);
+    }
+    out.width(0);
   }
   return out;
 }
 
+std::ostream& operator<<(std::ostream& out, const String& s) {
+  return out << StringView(s);
+}
+
+const size_t IO_CHUNK = 1 << 16;
+
+// Moves chars from the stream buffer into s until stop(ch) holds; the stop
+// char is consumed but not stored. Chars are staged in a local chunk so s
+// grows once per chunk instead of once per char.
+template <typename Stop>
+std::istream& read_until(std::istream& in, String& s, Stop stop) {
+  s.clear();
+  std::istream::sentry sentry(in, true);
+  if (!sentry) {
+    return in;
+  }
+  std::streambuf* buf = in.rdbuf();
+  char chunk[256];
+  size_t len = 0;
+  size_t extracted = 0;
+  std::ios_base::iostate state = std::ios_base::goodbit;
+  for (int ch = buf->sgetc();; ch = buf->snextc()) {
+    if (ch == std::char_traits<char>::eof()) {
+      state |= std::ios_base::eofbit;
+      break;
+    }
+    ++extracted;
+    if (stop(static_cast<char>(ch))) {
+      buf->sbumpc();
+      break;
+    }
+    chunk[len++] = static_cast<char>(ch);
+    if (len == sizeof(chunk)) {
+      s += StringView(chunk, len);
+      len = 0;
+    }
+  }
+  s += StringView(chunk, len);
+  if (extracted == 0) {
+    state |= std::ios_base::failbit;
+  }
+  in.setstate(state);
+  return in;
+}
+
 std::istream& operator>>(std::istream& in, String& s) {
+  return read_until(in, s, [](char ch) { return std::isspace(static_cast<unsigned char>(ch)) != 0; });
+}
+
+std::istream& getline(std::istream& in, String& s, char delim = '\n') {
+  return read_until(in, s, [delim](char ch) { return ch == delim; });
+}
+
+// Reads up to count chars in one sgetn call; sets eofbit and failbit when
+// the stream ends early, like std::istream::read.
+std::istream& read_bytes(std::istream& in, String& s, size_t count) {
   s.clear();
-  char ch;
-  while(in.get(ch) && !std::isspace(ch)) {
-    s.push_back(ch);
+  std::istream::sentry sentry(in, true);
+  if (!sentry) {
+    return in;
+  }
+  s.resize(count);
+  std::streamsize got = in.rdbuf()->sgetn(s.data(), static_cast<std::streamsize>(count));
+  s.resize(got);
+  if (static_cast<size_t>(got) < count) {
+    in.setstate(std::ios_base::eofbit | std::ios_base::failbit);
   }
   return in;
 }
+
+// Returns false when the file cannot be opened or is larger than
+// String::MAX_SIZE; use MappedFile for bigger inputs.
+bool read_file(const char* path, String& s) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  s.clear();
+  std::streambuf* buf = in.rdbuf();
+  std::streamoff size = buf->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+  buf->pubseekoff(0, std::ios_base::beg, std::ios_base::in);
+  if (size > static_cast<std::streamoff>(String::MAX_SIZE)) {
+    return false;
+  }
+  if (size > 0) {
+    s.resize(size);
+    s.resize(buf->sgetn(s.data(), size));
+  }
+  char chunk[IO_CHUNK];
+  for (std::streamsize got; (got = buf->sgetn(chunk, IO_CHUNK)) > 0;) {
+    if (static_cast<size_t>(got) > String::MAX_SIZE - s.size()) {
+      s.clear();
+      return false;
+    }
+    s += StringView(chunk, got);
+  }
+  return true;
+}
+
+// Read-only view of a whole file. On POSIX systems a regular file is mapped
+// into memory; pipes, devices and files that report size 0 (such as /proc
+// entries) are read into a buffer instead, as is everything elsewhere.
+class MappedFile {
+public:
+  MappedFile(): data_(""), size_(0), mapped_(false) {}
+
+  explicit MappedFile(const char* path): MappedFile() {
+    open(path);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    close();
+  }
+
+  bool open(const char* path) {
+    close();
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      ::close(fd);
+      return false;
+    }
+    if (!S_ISREG(info.st_mode) || info.st_size == 0) {
+      bool ok = ReadAll_(fd);
+      ::close(fd);
+      return ok;
+    }
+    void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      return false;
+    }
+    madvise(addr, info.st_size, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(addr);
+    size_ = info.st_size;
+    mapped_ = true;
+    ::close(fd);
+    return true;
+#else
+    if (!read_file(path, buffer_)) {
+      return false;
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+#endif
+  }
+
+  void close() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapped_) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+    buffer_.clear();
+    data_ = "";
+    size_ = 0;
+    mapped_ = false;
+  }
+
+  StringView view() const {
+    return StringView(data_, size_);
+  }
+
+  const char* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+private:
+#if defined(__unix__) || defined(__APPLE__)
+  bool ReadAll_(int fd) {
+    char chunk[IO_CHUNK];
+    for (;;) {
+      ssize_t got = ::read(fd, chunk, IO_CHUNK);
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      if (got < 0 || static_cast<size_t>(got) > String::MAX_SIZE - buffer_.size()) {
+        buffer_.clear();
+        return false;
+      }
+      if (got == 0) {
+        break;
+      }
+      buffer_ += StringView(chunk, got);
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+  }
+#endif
+
+  const char* data_;
+  size_t size_;
+  bool mapped_;
+  String buffer_;
+};
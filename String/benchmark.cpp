@@ -0,0 +1,752 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "String.cpp"
+
+size_t allocations = 0;
+
+void* operator new(size_t n) {
+  ++allocations;
+  void* p = malloc(n);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned overloads.
+void* operator new(size_t n, std::align_val_t al) {
+  ++allocations;
+  size_t alignment = static_cast<size_t>(al);
+  void* p = aligned_alloc(alignment, (n + alignment - 1) / alignment * alignment);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+  free(p);
+}
+
+volatile size_t sink = 0;
+
+struct BenchmarkResult {
+  std::string name;
+  size_t ops;
+  double ms;
+  size_t allocations;
+#if defined(STRING_INSTRUMENTATION)
+  StringStats stats;
+#endif
+};
+
+std::vector<BenchmarkResult> results;
+const char* filter = nullptr;
+
+// A wrong answer fails the run instead of being reported as a fast number.
+void check(bool ok, const std::string& what) {
+  if (!ok) {
+    std::cerr << "check failed: " << what << std::endl;
+    std::exit(1);
+  }
+}
+
+// Runs f once untimed to warm caches and the allocator, then once measured;
+// ops is the number of operations f performs, used for the per-operation
+// figures in the report. Returns false when the filter skipped it.
+template <typename F>
+bool run_benchmark(const std::string& name, size_t ops, F f) {
+  if (filter != nullptr && name.find(filter) == std::string::npos) {
+    return false;
+  }
+  f();
+#if defined(STRING_INSTRUMENTATION)
+  StringStats stats_before = string_stats();
+#endif
+  size_t allocations_before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto finish = std::chrono::steady_clock::now();
+  BenchmarkResult result;
+  result.name = name;
+  result.ops = ops;
+  result.ms = std::chrono::duration<double, std::milli>(finish - start).count();
+  result.allocations = allocations - allocations_before;
+#if defined(STRING_INSTRUMENTATION)
+  result.stats.allocations = string_stats().allocations - stats_before.allocations;
+  result.stats.reallocations = string_stats().reallocations - stats_before.reallocations;
+  result.stats.bytes_copied = string_stats().bytes_copied - stats_before.bytes_copied;
+#endif
+  results.push_back(result);
+  return true;
+}
+
+void print_json(std::ostream& out) {
+  out << "{\n  \"instrumented\": ";
+#if defined(STRING_INSTRUMENTATION)
+  out << "true";
+#else
+  out << "false";
+#endif
+  out << ",\n  \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchmarkResult& r = results[i];
+    double ops = static_cast<double>(std::max<size_t>(r.ops, 1));
+    out << (i == 0 ? "\n" : ",\n");
+    out << "    {\"name\": \"" << r.name << "\", \"ops\": " << r.ops << ", \"ms\": " << r.ms
+        << ", \"ns_per_op\": " << r.ms * 1e6 / ops << ", \"heap_allocations\": " << r.allocations
+        << ", \"heap_allocations_per_op\": " << r.allocations / ops;
+#if defined(STRING_INSTRUMENTATION)
+    out << ", \"string_allocations\": " << r.stats.allocations
+        << ", \"string_allocations_per_op\": " << r.stats.allocations / ops
+        << ", \"string_reallocations\": " << r.stats.reallocations
+        << ", \"string_reallocations_per_op\": " << r.stats.reallocations / ops
+        << ", \"string_bytes_copied\": " << r.stats.bytes_copied
+        << ", \"string_bytes_copied_per_op\": " << r.stats.bytes_copied / ops;
+#endif
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+const int ITERATIONS = 1000 * 1000;
+
+template <typename Str>
+void short_keys() {
+  char key[32];
+  for (int i = 0; i < ITERATIONS; ++i) {
+    snprintf(key, sizeof(key), "user:%d", i);
+    Str s(key);
+    Str copy = s;
+    sink = sink + copy.size();
+  }
+}
+
+template <typename Str>
+void long_construction() {
+  const char* text = "a key that is clearly too long for any small string buffer";
+  for (int i = 0; i < ITERATIONS; ++i) {
+    Str s(text);
+    sink = sink + s.size();
+  }
+}
+
+template <typename Str>
+void binary_concat() {
+  Str left("tenant-0001:");
+  Str right("session-0123456789");
+  for (int i = 0; i < ITERATIONS; ++i) {
+    Str s = left + right;
+    sink = sink + s.size();
+  }
+}
+
+template <typename Str>
+void char_concat() {
+  Str tail("id");
+  for (int i = 0; i < ITERATIONS; ++i) {
+    Str s = static_cast<char>('a' + i % 26) + tail;
+    sink = sink + s.size();
+  }
+}
+
+template <typename Str>
+void default_and_push_back() {
+  for (int i = 0; i < ITERATIONS; ++i) {
+    Str s;
+    for (int j = 0; j < 16; ++j) {
+      s.push_back(static_cast<char>('a' + j));
+    }
+    sink = sink + s.size();
+  }
+}
+
+std::string natural_text(size_t size) {
+  const char* words[] = {"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "request",
+                         "handler", "buffer", "string", "search", "pattern", "server", "client"};
+  std::string text;
+  unsigned seed = 1;
+  while (text.size() < size) {
+    seed = seed * 1103515245 + 12345;
+    text += words[(seed >> 16) % 16];
+    text += ' ';
+  }
+  return text;
+}
+
+template <typename Str>
+void substrings() {
+  Str text(natural_text(1 << 16).c_str());
+  for (int i = 0; i < ITERATIONS; ++i) {
+    Str part = text.substr(i % 60000, i % 2 == 0 ? 12 : 48);
+    sink = sink + part.size();
+  }
+}
+
+template <typename Str>
+void comparisons() {
+  std::vector<Str> keys;
+  char key[32];
+  for (int i = 0; i < 1000; ++i) {
+    snprintf(key, sizeof(key), "key:%d:%d", i % 37, i);
+    keys.emplace_back(key);
+  }
+  size_t hits = 0;
+  for (int i = 0; i < ITERATIONS; ++i) {
+    const Str& a = keys[i % 1000];
+    const Str& b = keys[(i * 7) % 1000];
+    hits += (a == b) + (a < b);
+  }
+  sink = sink + hits;
+}
+
+// Overlapping occurrences, like count_occurrences.
+size_t std_count(const std::string& text, const std::string& needle) {
+  size_t count = 0;
+  for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+const int SEARCHES = 20;
+
+template <typename Str>
+void search_workload(const char* name, const std::string& text, const std::string& needle, bool reverse) {
+  Str hay(text.c_str());
+  Str pattern(needle.c_str());
+  size_t found = 0;
+  bool ran = run_benchmark(name, SEARCHES, [&] {
+    for (int i = 0; i < SEARCHES; ++i) {
+      found = reverse ? hay.rfind(pattern) : hay.find(pattern);
+      sink = sink + found;
+    }
+  });
+  if (!ran) {
+    return;
+  }
+  size_t expected = reverse ? text.rfind(needle) : text.find(needle);
+  if (expected == std::string::npos) {
+    expected = text.size();
+  }
+  if (found == std::string::npos) {
+    found = text.size();
+  }
+  check(found == expected, name);
+}
+
+const int DOCUMENT_PIECES = 20000;
+
+void builder_benchmarks() {
+  String piece("<tr><td>cell</td><td>value</td></tr>\n");
+  String concatenated;
+  String flattened;
+  bool ran = run_benchmark("String repeated operator+", DOCUMENT_PIECES, [&] {
+    String document;
+    for (int i = 0; i < DOCUMENT_PIECES; ++i) {
+      document = document + piece;
+    }
+    concatenated = std::move(document);
+  });
+  ran &= run_benchmark("StringBuilder append + flatten", DOCUMENT_PIECES, [&] {
+    StringBuilder builder;
+    for (int i = 0; i < DOCUMENT_PIECES; ++i) {
+      builder += piece;
+    }
+    flattened = builder.flatten();
+  });
+  if (ran) {
+    check(concatenated == flattened, "StringBuilder append + flatten");
+  }
+  String a("alpha "), b("beta "), c("gamma "), d("delta "), e("epsilon");
+  run_benchmark("String a + b + c + d + e", ITERATIONS, [&] {
+    for (int i = 0; i < ITERATIONS; ++i) {
+      sink = sink + (a + b + c + d + e).size();
+    }
+  });
+  run_benchmark("StringBuilder a, b, c, d, e", ITERATIONS, [&] {
+    for (int i = 0; i < ITERATIONS; ++i) {
+      StringBuilder builder;
+      builder.append(a).append(b).append(c).append(d).append(e);
+      sink = sink + builder.flatten().size();
+    }
+  });
+  String text(natural_text(16 << 20).c_str());
+  String inserted;
+  ran = run_benchmark("String middle inserts", 100, [&] {
+    String copy = text;
+    for (int i = 0; i < 100; ++i) {
+      int pos = copy.size() / 2;
+      copy = copy.substr(0, pos) + piece + copy.substr(pos, copy.size() - pos);
+    }
+    inserted = std::move(copy);
+  });
+  StringBuilder edited;
+  ran &= run_benchmark("StringBuilder middle inserts", 100, [&] {
+    StringBuilder builder;
+    builder += text;
+    for (int i = 0; i < 100; ++i) {
+      builder.insert(builder.size() / 2, piece);
+    }
+    edited = std::move(builder);
+  });
+  if (ran) {
+    check(edited.flatten() == inserted, "StringBuilder middle inserts");
+    size_t third = inserted.size() / 3;
+    edited.erase(third, third);
+    String expected = inserted.substr(0, third) + inserted.substr(2 * third, inserted.size() - 2 * third);
+    check(edited.flatten() == expected, "StringBuilder erase");
+  }
+}
+
+const int REQUESTS = 10000;
+const int STRINGS_PER_REQUEST = 100;
+
+void request_workload(std::pmr::memory_resource* resource) {
+  for (int i = 0; i < STRINGS_PER_REQUEST; ++i) {
+    String header("X-Request-Header-With-A-Long-Name: ", resource);
+    header += "value-that-does-not-fit-inline";
+    sink = sink + header.size();
+  }
+}
+
+void arena_benchmarks() {
+  run_benchmark("String requests, default resource", REQUESTS * STRINGS_PER_REQUEST, [] {
+    for (int r = 0; r < REQUESTS; ++r) {
+      request_workload(std::pmr::get_default_resource());
+    }
+  });
+  run_benchmark("String requests, RequestArena", REQUESTS * STRINGS_PER_REQUEST, [] {
+    RequestArena arena(1 << 20);
+    for (int r = 0; r < REQUESTS; ++r) {
+      request_workload(arena.resource());
+      arena.release();
+    }
+  });
+}
+
+void tokenize_benchmark() {
+  String text(natural_text(8 << 20).c_str());
+  size_t tokens = 0;
+  for (StringView token : text.split(' ')) {
+    tokens += token.empty() ? 0 : 1;
+  }
+  run_benchmark("String split + substr_view tokenize", tokens, [&] {
+    size_t words = 0;
+    for (StringView token : text.split(' ')) {
+      words += token.size() > text.substr_view(0, 3).size() ? 1 : 0;
+    }
+    sink = sink + words;
+  });
+}
+
+const int HASH_KEYS = 100000;
+const int LOOKUPS = 1000 * 1000;
+
+template <typename Str>
+std::vector<Str> hash_keys(int count, const char* tag) {
+  std::vector<Str> keys;
+  char key[96];
+  for (int i = 0; i < count; ++i) {
+    snprintf(key, sizeof(key), "%s:%s:%d:%d", i % 3 == 0 ? "session-token-with-a-long-shared-prefix" : "user", tag,
+             i % 97, i);
+    keys.emplace_back(key);
+  }
+  return keys;
+}
+
+// Looks up every key of probes, half of which are absent; returns the sum of
+// the found values plus the number of misses.
+template <typename Str>
+size_t map_lookups(const std::unordered_map<Str, size_t>& map, const std::vector<Str>& probes) {
+  size_t total = 0;
+  for (int i = 0; i < LOOKUPS; ++i) {
+    auto it = map.find(probes[i % probes.size()]);
+    total += it == map.end() ? 1 : it->second;
+  }
+  return total;
+}
+
+void hash_benchmarks() {
+  std::vector<String> keys = hash_keys<String>(HASH_KEYS, "present");
+  std::vector<std::string> std_keys = hash_keys<std::string>(HASH_KEYS, "present");
+  for (size_t i = 0; i < keys.size(); ++i) {
+    check(keys[i].hash() == hash_bytes(std_keys[i].data(), std_keys[i].size()), "String::hash");
+  }
+  String edited(keys[0]);
+  edited.hash();
+  edited[0] = 'S';
+  check(edited.hash() == hash_bytes(edited.data(), edited.size()), "String::hash after operator[]");
+  edited += "-suffix";
+  check(edited.hash() == hash_bytes(edited.data(), edited.size()), "String::hash after +=");
+  edited.data()[1] = 'E';
+  check(edited.hash() == hash_bytes(edited.data(), edited.size()), "String::hash after data()");
+
+  size_t hashed = 0;
+  bool ran = run_benchmark("hash_bytes keys", HASH_KEYS, [&] {
+    hashed = 0;
+    for (const std::string& key : std_keys) {
+      hashed ^= hash_bytes(key.data(), key.size());
+    }
+    sink = sink + hashed;
+  });
+  run_benchmark("std::hash<std::string> keys", HASH_KEYS, [&] {
+    size_t result = 0;
+    for (const std::string& key : std_keys) {
+      result ^= std::hash<std::string>()(key);
+    }
+    sink = sink + result;
+  });
+  if (ran) {
+    size_t expected = 0;
+    for (const String& key : keys) {
+      expected ^= key.hash();
+    }
+    check(hashed == expected, "hash_bytes keys");
+  }
+
+  std::unordered_map<String, size_t> map;
+  std::unordered_map<std::string, size_t> std_map;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    map.emplace(keys[i], i + 2);
+    std_map.emplace(std_keys[i], i + 2);
+  }
+  std::vector<String> probes = hash_keys<String>(HASH_KEYS, "present");
+  std::vector<std::string> std_probes = hash_keys<std::string>(HASH_KEYS, "present");
+  std::vector<String> missing = hash_keys<String>(HASH_KEYS, "missing");
+  std::vector<std::string> std_missing = hash_keys<std::string>(HASH_KEYS, "missing");
+  probes.insert(probes.end(), missing.begin(), missing.end());
+  std_probes.insert(std_probes.end(), std_missing.begin(), std_missing.end());
+  size_t found = 0;
+  size_t std_found = 0;
+  ran = run_benchmark("String unordered_map lookups", LOOKUPS, [&] {
+    found = map_lookups(map, probes);
+    sink = sink + found;
+  });
+  ran &= run_benchmark("std::string unordered_map lookups", LOOKUPS, [&] {
+    std_found = map_lookups(std_map, std_probes);
+    sink = sink + std_found;
+  });
+  if (ran) {
+    check(found == std_found, "String unordered_map lookups");
+  }
+
+  std::string text = natural_text(4 << 20);
+  std::vector<StringView> words;
+  for (StringView word : StringView(text.data(), text.size()).split(' ')) {
+    if (!word.empty()) {
+      words.push_back(word);
+    }
+  }
+  size_t distinct = 0;
+  ran = run_benchmark("StringPool intern words", words.size(), [&] {
+    StringPool pool;
+    for (StringView word : words) {
+      sink = sink + pool.intern(word).hash();
+    }
+    distinct = pool.size();
+  });
+  size_t std_distinct = 0;
+  ran &= run_benchmark("std::unordered_set<std::string> intern words", words.size(), [&] {
+    std::unordered_set<std::string> pool;
+    for (StringView word : words) {
+      std::string key(word.data(), word.size());
+      sink = sink + pool.insert(key).first->size();
+    }
+    std_distinct = pool.size();
+  });
+  if (ran) {
+    check(distinct == std_distinct, "StringPool intern words");
+  }
+  StringPool pool;
+  std::unordered_map<std::string, InternedString> first_seen;
+  for (StringView word : words) {
+    InternedString interned = pool.intern(word);
+    check(interned.str() == word, "StringPool intern contents");
+    auto it = first_seen.emplace(std::string(word.data(), word.size()), interned).first;
+    check(&it->second.str() == &interned.str() && it->second == interned, "StringPool intern identity");
+  }
+  check(pool.size() == first_seen.size(), "StringPool size");
+  for (auto a = first_seen.begin(), b = std::next(a); b != first_seen.end(); ++a, ++b) {
+    check(a->second != b->second, "StringPool distinct words");
+  }
+
+  std::vector<String> sorted;
+  std::vector<std::string> std_sorted;
+  ran = run_benchmark("String sort LexicographicLess", probes.size(), [&] {
+    sorted = probes;
+    std::sort(sorted.begin(), sorted.end(), LexicographicLess());
+  });
+  ran &= run_benchmark("std::string sort", std_probes.size(), [&] {
+    std_sorted = std_probes;
+    std::sort(std_sorted.begin(), std_sorted.end());
+  });
+  if (ran) {
+    check(sorted.size() == std_sorted.size(), "String sort LexicographicLess");
+    for (size_t i = 0; i < sorted.size(); ++i) {
+      check(sorted[i] == StringView(std_sorted[i].data(), std_sorted[i].size()), "String sort LexicographicLess");
+    }
+  }
+}
+
+const char* IO_FILE = "string_benchmark_io.txt";
+
+template <typename Str>
+void write_words(const std::vector<Str>& words) {
+  std::ofstream out(IO_FILE, std::ios::binary);
+  for (const Str& word : words) {
+    out << word << ' ';
+  }
+}
+
+void io_benchmarks() {
+  std::string text = natural_text(64 << 20);
+  {
+    std::ofstream out(IO_FILE, std::ios::binary);
+    out << text;
+  }
+  size_t words = std::count(text.begin(), text.end(), ' ');
+  run_benchmark("String operator>> words", words, [] {
+    std::ifstream in(IO_FILE, std::ios::binary);
+    String word;
+    while (in >> word) {
+      sink = sink + word.size();
+    }
+  });
+  run_benchmark("std::string operator>> words", words, [] {
+    std::ifstream in(IO_FILE, std::ios::binary);
+    std::string word;
+    while (in >> word) {
+      sink = sink + word.size();
+    }
+  });
+  run_benchmark("String read_file", 1, [] {
+    String content;
+    read_file(IO_FILE, content);
+    sink = sink + content.size();
+  });
+  run_benchmark("std::string ifstream rdbuf", 1, [] {
+    std::ifstream in(IO_FILE, std::ios::binary);
+    std::ostringstream content;
+    content << in.rdbuf();
+    sink = sink + content.str().size();
+  });
+  run_benchmark("MappedFile split words", 1, [] {
+    MappedFile file(IO_FILE);
+    for (StringView word : file.view().split(' ')) {
+      sink = sink + word.size();
+    }
+  });
+  String content;
+  read_file(IO_FILE, content);
+  run_benchmark("String operator<< whole file", 1, [&] {
+    std::ofstream out(IO_FILE, std::ios::binary);
+    out << content;
+  });
+  run_benchmark("std::string operator<< whole file", 1, [&] {
+    std::ofstream out(IO_FILE, std::ios::binary);
+    out << text;
+  });
+  std::vector<String> string_words;
+  std::vector<std::string> std_words;
+  for (StringView word : content.substr_view(0, 1 << 20).split(' ')) {
+    string_words.emplace_back(word);
+    std_words.emplace_back(word.data(), word.size());
+  }
+  run_benchmark("String operator<< words", string_words.size(), [&] { write_words(string_words); });
+  run_benchmark("std::string operator<< words", std_words.size(), [&] { write_words(std_words); });
+  std::remove(IO_FILE);
+}
+
+void multi_pattern_benchmark() {
+  String text(natural_text(8 << 20).c_str());
+  std::vector<String> keywords;
+  char keyword[32];
+  for (int i = 0; i < 300; ++i) {
+    snprintf(keyword, sizeof(keyword), "%s%d", i % 2 == 0 ? "fox" : "handler ", i);
+    keywords.emplace_back(keyword);
+  }
+  keywords.emplace_back("lazy dog");
+  keywords.emplace_back("quick brown");
+  std::vector<StringView> views(keywords.begin(), keywords.end());
+  MultiPatternMatcher matcher(views);
+  size_t find_hits = 0;
+  bool ran = run_benchmark("String find per keyword", keywords.size(), [&] {
+    find_hits = 0;
+    for (const String& word : keywords) {
+      for (size_t pos = text.find(word); pos != text.size(); pos = text.find(word, pos + 1)) {
+        ++find_hits;
+      }
+    }
+    sink = sink + find_hits;
+  });
+  size_t scan_hits = 0;
+  ran &= run_benchmark("MultiPatternMatcher scan", 1, [&] {
+    scan_hits = 0;
+    matcher.scan(text, [&scan_hits](const PatternMatch&) { ++scan_hits; });
+    sink = sink + scan_hits;
+  });
+  if (!ran) {
+    return;
+  }
+  std::string std_text(text.data(), text.size());
+  size_t expected = 0;
+  for (const String& word : keywords) {
+    expected += std_count(std_text, std::string(word.data(), word.size()));
+  }
+  check(find_hits == expected, "String find per keyword");
+  check(scan_hits == expected, "MultiPatternMatcher scan");
+  std::vector<PatternMatch> matches = matcher.find_all(text);
+  check(matches.size() == expected, "MultiPatternMatcher find_all");
+  for (const PatternMatch& match : matches) {
+    const String& word = keywords[match.pattern];
+    check(match.offset + word.size() <= text.size() &&
+              memcmp(text.data() + match.offset, word.data(), word.size()) == 0,
+          "MultiPatternMatcher find_all");
+  }
+}
+
+void parallel_benchmarks() {
+  String text(natural_text(64 << 20).c_str());
+  StringView needle("server handler waits");
+  StringView common("fox");
+  std::string std_text(text.data(), text.size());
+  std::string std_needle(needle.data(), needle.size());
+  size_t expected_find = std::min(std_text.find(std_needle), std_text.size());
+  size_t expected_rfind = std::min(std_text.rfind(std_needle), std_text.size());
+  size_t expected_count = std_count(std_text, std::string(common.data(), common.size()));
+  for (size_t threads : {1, 2, 4, 8}) {
+    ThreadPool pool(threads);
+    std::string suffix = " (" + std::to_string(threads) + " threads)";
+    size_t result = 0;
+    if (run_benchmark("par_find" + suffix, 1, [&] { sink = sink + (result = par_find(text, needle, pool)); })) {
+      check(result == expected_find, "par_find" + suffix);
+    }
+    if (run_benchmark("par_rfind" + suffix, 1, [&] { sink = sink + (result = par_rfind(text, needle, pool)); })) {
+      check(result == expected_rfind, "par_rfind" + suffix);
+    }
+    if (run_benchmark("par_count" + suffix, 1, [&] { sink = sink + (result = par_count(text, common, pool)); })) {
+      check(result == expected_count, "par_count" + suffix);
+    }
+  }
+}
+
+void search_benchmarks() {
+  std::string text = natural_text(8 << 20);
+  std::string adversarial(8 << 20, 'a');
+  const std::string short_needle = "fox jumps over the lazy cat";
+  const std::string long_needle = "the quick brown fox jumps over the lazy dog while the server handler waits";
+  const std::string adversarial_short = std::string(15, 'a') + "b";
+  const std::string adversarial_long = std::string(255, 'a') + "b";
+  const std::string present = text.substr(text.size() / 4 * 3, 40);
+
+  search_workload<String>("String find short needle (text)", text, short_needle, false);
+  search_workload<std::string>("std::string find short needle (text)", text, short_needle, false);
+  search_workload<String>("String rfind short needle (text)", text, short_needle, true);
+  search_workload<std::string>("std::string rfind short needle (text)", text, short_needle, true);
+  search_workload<String>("String find long needle (text)", text, long_needle, false);
+  search_workload<std::string>("std::string find long needle (text)", text, long_needle, false);
+  search_workload<String>("String rfind long needle (text)", text, long_needle, true);
+  search_workload<std::string>("std::string rfind long needle (text)", text, long_needle, true);
+  search_workload<String>("String find present needle (text)", text, present, false);
+  search_workload<std::string>("std::string find present needle (text)", text, present, false);
+  search_workload<String>("String rfind present needle (text)", text, present, true);
+  search_workload<std::string>("std::string rfind present needle (text)", text, present, true);
+  search_workload<String>("String find short needle (a^n)", adversarial, adversarial_short, false);
+  search_workload<std::string>("std::string find short needle (a^n)", adversarial, adversarial_short, false);
+  search_workload<String>("String find long needle (a^n)", adversarial, adversarial_long, false);
+  search_workload<std::string>("std::string find long needle (a^n)", adversarial, adversarial_long, false);
+  search_workload<String>("String rfind long needle (a^n)", adversarial, adversarial_long, true);
+  search_workload<std::string>("std::string rfind long needle (a^n)", adversarial, adversarial_long, true);
+}
+
+const int PIECES = 1000 * 1000;
+
+template <typename Str>
+void append_pieces() {
+  Str piece("piece-");
+  Str result;
+  for (int i = 0; i < PIECES; ++i) {
+    result += piece;
+    result += static_cast<char>('0' + i % 10);
+  }
+  sink = sink + result.size();
+}
+
+template <typename Str>
+void concat_pieces() {
+  Str piece("piece-");
+  Str result;
+  for (int i = 0; i < PIECES; ++i) {
+    result = std::move(result) + piece + static_cast<char>('0' + i % 10);
+  }
+  sink = sink + result.size();
+}
+
+template <typename Str>
+void reserve_and_append() {
+  Str piece("piece-");
+  Str result;
+  result.reserve(PIECES * 7);
+  for (int i = 0; i < PIECES; ++i) {
+    result += piece;
+  }
+  sink = sink + result.size();
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    filter = argv[1];
+  }
+  run_benchmark("String short keys", ITERATIONS, short_keys<String>);
+  run_benchmark("std::string short keys", ITERATIONS, short_keys<std::string>);
+  run_benchmark("String long construction", ITERATIONS, long_construction<String>);
+  run_benchmark("std::string long construction", ITERATIONS, long_construction<std::string>);
+  run_benchmark("String + String", ITERATIONS, binary_concat<String>);
+  run_benchmark("std::string + std::string", ITERATIONS, binary_concat<std::string>);
+  run_benchmark("String char + String", ITERATIONS, char_concat<String>);
+  run_benchmark("std::string char + std::string", ITERATIONS, char_concat<std::string>);
+  run_benchmark("String default + push_back", ITERATIONS, default_and_push_back<String>);
+  run_benchmark("std::string default + push_back", ITERATIONS, default_and_push_back<std::string>);
+  run_benchmark("String += pieces", PIECES, append_pieces<String>);
+  run_benchmark("std::string += pieces", PIECES, append_pieces<std::string>);
+  run_benchmark("String move + pieces", PIECES, concat_pieces<String>);
+  run_benchmark("std::string move + pieces", PIECES, concat_pieces<std::string>);
+  run_benchmark("String reserve + append", PIECES, reserve_and_append<String>);
+  run_benchmark("std::string reserve + append", PIECES, reserve_and_append<std::string>);
+  run_benchmark("String substr", ITERATIONS, substrings<String>);
+  run_benchmark("std::string substr", ITERATIONS, substrings<std::string>);
+  run_benchmark("String == and <", ITERATIONS, comparisons<String>);
+  run_benchmark("std::string == and <", ITERATIONS, comparisons<std::string>);
+  hash_benchmarks();
+  builder_benchmarks();
+  arena_benchmarks();
+  tokenize_benchmark();
+  io_benchmarks();
+  search_benchmarks();
+  multi_pattern_benchmark();
+  parallel_benchmarks();
+  print_json(std::cout);
+}